@@ -0,0 +1,554 @@
+//
+// image_to_c benchmark
+//
+// Generates a synthetic corpus of image files and times the
+// header probe (ImageInfo), the GIF frame walker (CountGIFFrames),
+// the hex formatter (MakeC) and the checksums separately.
+// The results are written to stdout as one JSON record per line
+// so that they can be compared from run to run.
+//
+// Written by Larry Bank
+// Copyright (c) 2020 BitBank Software, Inc.
+//
+#define IMAGE_TO_C_NO_MAIN
+#include "main.c"
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MIN_BENCH_TIME 0.25 // seconds to run each test (at least)
+#define GIF_FRAMES 8
+
+enum
+{
+    GROUP_TINY = 0,
+    GROUP_SMALL,
+    GROUP_MEDIUM,
+    GROUP_HUGE,
+    GROUP_COUNT
+};
+
+typedef struct tag_benchgroup
+{
+    const char *szName;
+    int iWidth, iHeight;
+    int iCopies; // number of files of each type
+} BENCHGROUP;
+
+const BENCHGROUP groups[GROUP_COUNT] = {
+    {"tiny", 16, 16, 150},
+    {"small", 64, 64, 20},
+    {"medium", 640, 480, 4},
+    {"huge", 2048, 2048, 1}
+};
+
+typedef struct tag_benchfile
+{
+    char szName[MAX_PATH_LEN];
+    int iType;
+    int iSize;
+} BENCHFILE;
+
+static BENCHFILE *pFiles[GROUP_COUNT];
+static int iFileCount[GROUP_COUNT];
+static FILE *fResults; // stdout is redirected while MakeC() runs
+static long lRSSStart; // peak RSS when the current bench started
+static uint32_t u32Seed = 0x12345678;
+
+//
+// Fill a buffer with pseudo-random bytes (xorshift32)
+//
+void FillRandom(uint8_t *p, int iLen)
+{
+    uint32_t x = u32Seed;
+    int i;
+
+    for (i=0; i<iLen; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        p[i] = (uint8_t)x;
+    }
+    u32Seed = x;
+} /* FillRandom() */
+
+void PutIntelShort(uint8_t *p, int i)
+{
+    p[0] = (uint8_t)i;
+    p[1] = (uint8_t)(i >> 8);
+} /* PutIntelShort() */
+
+void PutIntelLong(uint8_t *p, uint32_t u32)
+{
+    p[0] = (uint8_t)u32;
+    p[1] = (uint8_t)(u32 >> 8);
+    p[2] = (uint8_t)(u32 >> 16);
+    p[3] = (uint8_t)(u32 >> 24);
+} /* PutIntelLong() */
+
+void PutMotoShort(uint8_t *p, int i)
+{
+    p[0] = (uint8_t)(i >> 8);
+    p[1] = (uint8_t)i;
+} /* PutMotoShort() */
+
+void PutMotoLong(uint8_t *p, uint32_t u32)
+{
+    p[0] = (uint8_t)(u32 >> 24);
+    p[1] = (uint8_t)(u32 >> 16);
+    p[2] = (uint8_t)(u32 >> 8);
+    p[3] = (uint8_t)u32;
+} /* PutMotoLong() */
+
+void PutTIFFTag(uint8_t *p, int iTag, int iType, uint32_t u32Value)
+{
+    PutIntelShort(p, iTag);
+    PutIntelShort(&p[2], iType);
+    PutIntelLong(&p[4], 1); // count
+    PutIntelLong(&p[8], u32Value);
+} /* PutTIFFTag() */
+//
+// Build a synthetic file of the given type in memory
+// The headers are valid; the image data is random
+// Returns the file size
+//
+int MakeFile(uint8_t *pOut, int iType, int iWidth, int iHeight)
+{
+    int i, iOff, iData, iLen;
+
+    switch (iType)
+    {
+        case FILETYPE_BMP: // 24-bpp Windows BMP
+            iData = ((iWidth * 3 + 3) & ~3) * iHeight;
+            memset(pOut, 0, 54);
+            pOut[0] = 'B'; pOut[1] = 'M';
+            PutIntelLong(&pOut[2], 54 + iData);
+            PutIntelLong(&pOut[10], 54); // OffBits
+            PutIntelLong(&pOut[14], 40); // BITMAPINFOHEADER
+            PutIntelLong(&pOut[18], iWidth);
+            PutIntelLong(&pOut[22], iHeight);
+            PutIntelShort(&pOut[26], 1); // planes
+            PutIntelShort(&pOut[28], 24); // bits per pixel
+            PutIntelLong(&pOut[34], iData);
+            FillRandom(&pOut[54], iData);
+            return 54 + iData;
+        case FILETYPE_PPM: // 24-bpp binary pixmap
+            iOff = sprintf((char *)pOut, "P6\n# image_to_c benchmark\n%d %d\n255\n", iWidth, iHeight);
+            iData = iWidth * iHeight * 3;
+            FillRandom(&pOut[iOff], iData);
+            return iOff + iData;
+        case FILETYPE_TARGA: // 24-bpp uncompressed
+            memset(pOut, 0, 18);
+            pOut[2] = 2; // true color
+            PutIntelShort(&pOut[12], iWidth);
+            PutIntelShort(&pOut[14], iHeight);
+            pOut[16] = 24;
+            iData = iWidth * iHeight * 3;
+            FillRandom(&pOut[18], iData);
+            return 18 + iData;
+        case FILETYPE_TIFF: // 8-bpp grayscale, single uncompressed strip
+            iData = iWidth * iHeight;
+            pOut[0] = pOut[1] = 'I';
+            PutIntelShort(&pOut[2], 42);
+            PutIntelLong(&pOut[4], 8); // first IFD
+            PutIntelShort(&pOut[8], 7); // number of tags
+            iOff = 10;
+            PutTIFFTag(&pOut[iOff], 256, 4, iWidth); iOff += TIFF_TAGSIZE;
+            PutTIFFTag(&pOut[iOff], 257, 4, iHeight); iOff += TIFF_TAGSIZE;
+            PutTIFFTag(&pOut[iOff], 258, 3, 8); iOff += TIFF_TAGSIZE;
+            PutTIFFTag(&pOut[iOff], 259, 3, 1); iOff += TIFF_TAGSIZE;
+            PutTIFFTag(&pOut[iOff], 262, 3, 1); iOff += TIFF_TAGSIZE;
+            PutTIFFTag(&pOut[iOff], 273, 4, iOff + 2*TIFF_TAGSIZE + 4); iOff += TIFF_TAGSIZE;
+            PutTIFFTag(&pOut[iOff], 279, 4, iData); iOff += TIFF_TAGSIZE;
+            PutIntelLong(&pOut[iOff], 0); // no more IFDs
+            iOff += 4;
+            FillRandom(&pOut[iOff], iData);
+            return iOff + iData;
+        case FILETYPE_GIF: // 8-bpp, multiple frames
+            memcpy(pOut, "GIF89a", 6);
+            PutIntelShort(&pOut[6], iWidth);
+            PutIntelShort(&pOut[8], iHeight);
+            pOut[10] = 0xf7; // global color table of 256 entries
+            pOut[11] = pOut[12] = 0;
+            iOff = 13;
+            FillRandom(&pOut[iOff], 768);
+            iOff += 768;
+            iData = (iWidth * iHeight) / 2; // compressed data per frame
+            for (i=0; i<GIF_FRAMES; i++)
+            {
+                // graphic control extension
+                pOut[iOff++] = 0x21; pOut[iOff++] = 0xf9; pOut[iOff++] = 4;
+                pOut[iOff++] = 0; pOut[iOff++] = 10; pOut[iOff++] = 0; pOut[iOff++] = 0;
+                pOut[iOff++] = 0;
+                // image descriptor
+                pOut[iOff++] = 0x2c;
+                PutIntelShort(&pOut[iOff], 0); PutIntelShort(&pOut[iOff+2], 0);
+                PutIntelShort(&pOut[iOff+4], iWidth); PutIntelShort(&pOut[iOff+6], iHeight);
+                pOut[iOff+8] = 0; // no local color table
+                iOff += 9;
+                pOut[iOff++] = 8; // LZW code size
+                iLen = iData;
+                while (iLen > 0) // data sub-blocks
+                {
+                    int iBlock = (iLen > 255) ? 255 : iLen;
+                    pOut[iOff++] = (uint8_t)iBlock;
+                    FillRandom(&pOut[iOff], iBlock);
+                    iOff += iBlock;
+                    iLen -= iBlock;
+                }
+                pOut[iOff++] = 0; // block terminator
+            }
+            pOut[iOff++] = 0x3b;
+            return iOff;
+        case FILETYPE_PNG: // 32-bpp RGBA
+            memcpy(pOut, "\x89PNG\r\n\x1a\n", 8);
+            PutMotoLong(&pOut[8], 13);
+            PutMotoLong(&pOut[12], 0x49484452); // IHDR
+            PutMotoLong(&pOut[16], iWidth);
+            PutMotoLong(&pOut[20], iHeight);
+            pOut[24] = 8; pOut[25] = 6; pOut[26] = pOut[27] = pOut[28] = 0;
+            PutMotoLong(&pOut[29], 0); // CRC (not checked)
+            iData = (iWidth * iHeight * 4) / 2;
+            FillRandom(&pOut[33], iData);
+            return 33 + iData;
+        case FILETYPE_JPEG: // 24-bpp baseline
+            iOff = 0;
+            PutMotoShort(&pOut[iOff], 0xffd8); iOff += 2;
+            PutMotoShort(&pOut[iOff], 0xffe0); PutMotoShort(&pOut[iOff+2], 16);
+            memcpy(&pOut[iOff+4], "JFIF\0\1\1\0\0\1\0\1\0\0", 14);
+            iOff += 18;
+            PutMotoShort(&pOut[iOff], 0xffc0); PutMotoShort(&pOut[iOff+2], 17);
+            pOut[iOff+4] = 8;
+            PutMotoShort(&pOut[iOff+5], iHeight);
+            PutMotoShort(&pOut[iOff+7], iWidth);
+            pOut[iOff+9] = 3;
+            for (i=0; i<3; i++)
+            {
+                pOut[iOff+10+i*3] = i+1;
+                pOut[iOff+11+i*3] = (i == 0) ? 0x22 : 0x11;
+                pOut[iOff+12+i*3] = (i == 0) ? 0 : 1;
+            }
+            iOff += 19;
+            iData = (iWidth * iHeight * 3) / 8;
+            FillRandom(&pOut[iOff], iData);
+            iOff += iData;
+            PutMotoShort(&pOut[iOff], 0xffd9);
+            return iOff + 2;
+    }
+    return 0;
+} /* MakeFile() */
+//
+// Build the list of corpus files; if bWrite is set, generate them too,
+// otherwise take the sizes of the files already on disk
+//
+int MakeCorpus(const char *szDir, int bWrite)
+{
+    const int iTypes[] = {FILETYPE_BMP, FILETYPE_PPM, FILETYPE_TARGA, FILETYPE_GIF, FILETYPE_TIFF, FILETYPE_PNG, FILETYPE_JPEG};
+    const char *szExt[] = {"bmp", "ppm", "tga", "gif", "tif", "png", "jpg"};
+    const int iNumTypes = sizeof(iTypes) / sizeof(int);
+    uint8_t *pBuf = NULL;
+    int iGroup, iType, iCopy, iMax;
+    BENCHFILE *pBF;
+    struct stat st;
+    FILE *f;
+
+    if (bWrite)
+        mkdir(szDir, 0755);
+    for (iGroup=0; iGroup<GROUP_COUNT; iGroup++)
+    {
+        const BENCHGROUP *pG = &groups[iGroup];
+        // worst case is the multi-frame GIF
+        iMax = 4096 + pG->iWidth * pG->iHeight * 4 + GIF_FRAMES * ((pG->iWidth * pG->iHeight) / 2 + (pG->iWidth * pG->iHeight) / 510 + 32);
+        if (bWrite)
+        {
+            pBuf = (uint8_t *)malloc(iMax);
+            if (pBuf == NULL)
+                return -1;
+        }
+        pFiles[iGroup] = (BENCHFILE *)malloc(iNumTypes * pG->iCopies * sizeof(BENCHFILE));
+        if (pFiles[iGroup] == NULL)
+            return -1;
+        for (iType=0; iType<iNumTypes; iType++)
+        {
+            for (iCopy=0; iCopy<pG->iCopies; iCopy++)
+            {
+                pBF = &pFiles[iGroup][iFileCount[iGroup]++];
+                snprintf(pBF->szName, MAX_PATH_LEN, "%s/%s_%d.%s", szDir, pG->szName, iCopy, szExt[iType]);
+                pBF->iType = iTypes[iType];
+                if (!bWrite)
+                {
+                    if (stat(pBF->szName, &st) != 0)
+                        return -1;
+                    pBF->iSize = (int)st.st_size;
+                    continue;
+                }
+                pBF->iSize = MakeFile(pBuf, iTypes[iType], pG->iWidth, pG->iHeight);
+                f = fopen(pBF->szName, "wb");
+                if (f == NULL)
+                {
+                    fprintf(stderr, "Unable to create %s\n", pBF->szName);
+                    free(pBuf);
+                    return -1;
+                }
+                fwrite(pBuf, 1, pBF->iSize, f);
+                fclose(f);
+            }
+        }
+        free(pBuf);
+        pBuf = NULL;
+    }
+    return 0;
+} /* MakeCorpus() */
+//
+// Generate the corpus in a child process so that its buffers
+// don't show up in our peak RSS, then list what it wrote
+//
+int PrepareCorpus(const char *szDir)
+{
+    pid_t pid;
+    int iStatus;
+
+    fflush(NULL);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+        _exit(MakeCorpus(szDir, 1) == 0 ? 0 : 1);
+    if (waitpid(pid, &iStatus, 0) != pid || !WIFEXITED(iStatus) || WEXITSTATUS(iStatus) != 0)
+        return -1;
+    return MakeCorpus(szDir, 0);
+} /* PrepareCorpus() */
+
+double GetTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+} /* GetTime() */
+
+long GetPeakRSS(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024; // bytes on MacOS
+#else
+    return ru.ru_maxrss; // KB on Linux
+#endif
+} /* GetPeakRSS() */
+
+//
+// iFiles = total number of files processed (including repeats)
+// rss_growth_kb is how much this bench raised the high-water mark
+//
+void PrintResult(const char *szBench, int iGroup, int iFiles, double dBytes, double dTime)
+{
+    long lPeak = GetPeakRSS();
+
+    fprintf(fResults, "{\"bench\":\"%s\",\"corpus\":\"%s\",\"files\":%d,\"bytes\":%.0f,\"seconds\":%.6f,\"mb_per_s\":%.2f,\"files_per_s\":%.1f,\"peak_rss_kb\":%ld,\"rss_growth_kb\":%ld}\n",
+            szBench, groups[iGroup].szName, iFiles, dBytes, dTime,
+            dBytes / (1024.0 * 1024.0) / dTime, (double)iFiles / dTime, lPeak, lPeak - lRSSStart);
+    fflush(fResults);
+} /* PrintResult() */
+//
+// Read a corpus file into a new buffer
+// Returns NULL (with nothing left open) if it can't be read
+//
+uint8_t * LoadFile(const BENCHFILE *pBF)
+{
+    uint8_t *pData;
+    FILE *f;
+
+    f = fopen(pBF->szName, "rb");
+    if (f == NULL)
+        return NULL;
+    pData = (uint8_t *)malloc(pBF->iSize);
+    if (pData != NULL && fread(pData, 1, pBF->iSize, f) != (size_t)pBF->iSize)
+    {
+        free(pData);
+        pData = NULL;
+    }
+    fclose(f);
+    if (pData == NULL)
+        fprintf(stderr, "Unable to read %s\n", pBF->szName);
+    return pData;
+} /* LoadFile() */
+//
+// Open + probe each file of the group (same as main() does)
+// The probe only reads the headers, so the byte count comes from
+// the I/O counters rather than the file sizes
+//
+void BenchImageInfo(int iGroup)
+{
+    int i, iIters = 0, iSize;
+    double dStart, dTime;
+    IMAGEINFO ii;
+    FILE *f;
+
+    lRSSStart = GetPeakRSS();
+    memset(&stats, 0, sizeof(stats));
+    bStats = 1;
+    dStart = GetTime();
+    do {
+        for (i=0; i<iFileCount[iGroup]; i++)
+        {
+            f = fopen(pFiles[iGroup][i].szName, "rb");
+            if (f == NULL)
+                continue;
+            fseek(f, 0L, SEEK_END);
+            iSize = (int)ftell(f);
+            fseek(f, 0, SEEK_SET);
+            if (ImageInfo(f, iSize, &ii) < 0 || ii.iFileType != pFiles[iGroup][i].iType)
+                fprintf(stderr, "Probe failed: %s\n", pFiles[iGroup][i].szName);
+            fclose(f);
+        }
+        iIters++;
+        dTime = GetTime() - dStart;
+    } while (dTime < MIN_BENCH_TIME);
+    bStats = 0;
+    PrintResult("ImageInfo", iGroup, iFileCount[iGroup] * iIters, (double)stats.u64BytesRead, dTime);
+} /* BenchImageInfo() */
+//
+// Walk the frames of each GIF in the group (already in memory)
+//
+void BenchGIFFrames(int iGroup)
+{
+    int i, iIters = 0, iFiles = 0, iFrames = 0;
+    double dStart, dTime = 0, dBytes = 0;
+    uint8_t *pData;
+
+    lRSSStart = GetPeakRSS();
+    for (i=0; i<iFileCount[iGroup]; i++)
+    {
+        BENCHFILE *pBF = &pFiles[iGroup][i];
+        if (pBF->iType != FILETYPE_GIF)
+            continue;
+        pData = LoadFile(pBF);
+        if (pData == NULL)
+            return;
+        iIters = 0;
+        dStart = GetTime();
+        do {
+            iFrames = CountGIFFrames(pData, pBF->iSize);
+            iIters++;
+        } while (GetTime() - dStart < MIN_BENCH_TIME / groups[iGroup].iCopies);
+        dTime += GetTime() - dStart;
+        dBytes += (double)pBF->iSize * iIters;
+        iFiles += iIters;
+        free(pData);
+        if (iFrames != GIF_FRAMES)
+            fprintf(stderr, "Frame count failed: %s (%d frames)\n", pBF->szName, iFrames);
+    }
+    PrintResult("CountGIFFrames", iGroup, iFiles, dBytes, dTime);
+} /* BenchGIFFrames() */
+//
+// Convert each file of the group (already in memory) to hex text
+//
+void BenchMakeC(int iGroup)
+{
+    int i, iIters = 0, iFiles = 0, iOff, iLen;
+    double dStart, dTime = 0, dBytes = 0;
+    uint8_t *pData;
+
+    lRSSStart = GetPeakRSS();
+    for (i=0; i<iFileCount[iGroup]; i++)
+    {
+        BENCHFILE *pBF = &pFiles[iGroup][i];
+        pData = LoadFile(pBF);
+        if (pData == NULL)
+            return;
+        iIters = 0;
+        dStart = GetTime();
+        do {
+            for (iOff = 0; iOff < pBF->iSize; iOff += iLen) // 64k at a time like main()
+            {
+                iLen = pBF->iSize - iOff;
+                if (iLen > 0x10000) iLen = 0x10000;
+                MakeC(&pData[iOff], iLen, iOff + iLen == pBF->iSize);
+            }
+            fflush(stdout);
+            iIters++;
+        } while (GetTime() - dStart < MIN_BENCH_TIME / iFileCount[iGroup]);
+        dTime += GetTime() - dStart;
+        dBytes += (double)pBF->iSize * iIters;
+        iFiles += iIters;
+        free(pData);
+    }
+    PrintResult("MakeC", iGroup, iFiles, dBytes, dTime);
+} /* BenchMakeC() */
+
+//
+// Run the CRC/hash over each file of the group (already in memory)
+//
+void BenchChecksum(int iGroup, const char *szBench, int iCRC, int bHash)
+{
+    int i, iIters = 0, iFiles = 0;
+    double dStart, dTime = 0, dBytes = 0;
+    uint8_t *pData;
+
+    lRSSStart = GetPeakRSS();
+    iCRCType = iCRC;
+    bHash64 = bHash;
+    ChecksumInit();
+    for (i=0; i<iFileCount[iGroup]; i++)
+    {
+        BENCHFILE *pBF = &pFiles[iGroup][i];
+        pData = LoadFile(pBF);
+        if (pData == NULL)
+        {
+            iCRCType = CRC_NONE;
+            bHash64 = 0;
+            return;
+        }
+        iIters = 0;
+        dStart = GetTime();
+        do {
+            ChecksumUpdate(pData, pBF->iSize);
+            iIters++;
+        } while (GetTime() - dStart < MIN_BENCH_TIME / iFileCount[iGroup]);
+        dTime += GetTime() - dStart;
+        dBytes += (double)pBF->iSize * iIters;
+        iFiles += iIters;
+        free(pData);
+    }
+    iCRCType = CRC_NONE;
+    bHash64 = 0;
+    PrintResult(szBench, iGroup, iFiles, dBytes, dTime);
+} /* BenchChecksum() */
+
+int main(int argc, char *argv[])
+{
+    int iGroup;
+    const char *szDir = "bench_corpus";
+
+    if (argc > 1)
+        szDir = argv[1];
+    // keep the results on the real stdout; the generated hex goes to the bit bucket
+    fResults = fdopen(dup(fileno(stdout)), "w");
+    if (fResults == NULL || freopen("/dev/null", "w", stdout) == NULL)
+    {
+        fprintf(stderr, "Unable to redirect stdout\n");
+        return -1;
+    }
+    ohandle = stdout;
+    if (PrepareCorpus(szDir) != 0)
+    {
+        fprintf(stderr, "Unable to create the corpus in %s\n", szDir);
+        return -1;
+    }
+    for (iGroup=0; iGroup<GROUP_COUNT; iGroup++)
+    {
+        BenchImageInfo(iGroup);
+        BenchGIFFrames(iGroup);
+        BenchMakeC(iGroup);
+        BenchChecksum(iGroup, "crc32", CRC_32, 0);
+        BenchChecksum(iGroup, "crc32c", CRC_32C, 0);
+        BenchChecksum(iGroup, "hash64", CRC_NONE, 1);
+    }
+    fclose(fResults);
+    return 0;
+} /* main() */
@@ -10,11 +10,45 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/stat.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define HAS_SSE42_CRC
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAS_ARM_CRC
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 
 #define TEMP_BUF_SIZE 4096
 #define DEFAULT_READ_SIZE 256
 #define MAX_TAGS 256
 #define TIFF_TAGSIZE 12
+#define MAX_PATH_LEN 1024
+#define MAX_THREADS 64
+#define WATCH_DEBOUNCE_MS 100 // wait for this much quiet before converting
+#define SHARD_SECTION_ALIGN 32 // compilers align large arrays (GCC: 32 on x86-64, 4-16 on ARM)
+
+// --watch converts several files at once, so the per-file state is per thread
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
 
 #define INTELSHORT(p) ((*p) + (*(p+1)<<8))
 #define INTELLONG(p) ((*p) + (*(p+1)<<8) + (*(p+2)<<16) + (*(p+3)<<24))
@@ -66,11 +100,357 @@ enum
     COMPTYPE_JBIG
 };
 
-FILE * ihandle;
+//
+// Everything ImageInfo() learns about a file
+//
+typedef struct tag_imageinfo
+{
+    int iFileType;
+    int iCompression;
+    int iWidth, iHeight, iBpp;
+    int iFrames; // number of frames (GIF), otherwise 1
+    int iDataOff; // offset to the image data (TIFF & BMP only)
+    int iDataSize; // size of the image data (TIFF & BMP only)
+    char szOptions[64]; // extra type-specific info
+} IMAGEINFO;
+
+//
+// One line of the --info manifest
+//
+typedef struct tag_proberecord
+{
+    char *szName;
+    int iFileSize;
+    int iResult; // return value of ImageInfo(), -1 = unknown/unreadable
+    IMAGEINFO ii;
+} PROBERECORD;
+
+//
+// --stats phases; the time spent in each one is accumulated
+//
+enum
+{
+    PHASE_OTHER = 0,
+    PHASE_OPEN,
+    PHASE_PROBE,
+    PHASE_GIF,
+    PHASE_READ,
+    PHASE_FORMAT,
+    PHASE_WRITE,
+    PHASE_CHECKSUM,
+    PHASE_COUNT
+};
+const char *szPhase[] = {"other", "open", "probe", "gif_frames", "read", "format", "write", "checksum"};
+
+typedef struct tag_iostats
+{
+    uint64_t u64Time[PHASE_COUNT]; // nanoseconds
+    uint64_t u64BytesRead, u64BytesWritten;
+    int iReads, iSeeks, iWrites; // number of stdio calls
+    int iAllocs;
+    int iLargestAlloc;
+} IOSTATS;
+
+static int bStats = 0; // only collect them when asked
+static IOSTATS stats;
+static int iCurrentPhase = -1;
+static uint64_t u64PhaseStart;
+
+enum
+{
+    CRC_NONE = 0,
+    CRC_32, // IEEE 802.3 (same as zlib)
+    CRC_32C // Castagnoli
+};
+//
+// Checksums of the array data, computed as it's written
+//
+static int iCRCType = CRC_NONE;
+static int bHash64 = 0;
+static int bCRCHardware = 0;
+static THREAD_LOCAL uint32_t u32CRC;
+static THREAD_LOCAL uint64_t u64Hash;
+static uint32_t u32CRCTable[8][256]; // slice-by-8 tables
+static int iCRCTableType = CRC_NONE; // which CRC the tables hold
+
+//
+// Conversion options (everything except the file names)
+//
+typedef struct tag_convopts
+{
+    int bStrip;
+    int iShardSize, bShardSection;
+    int iAlign, iDMAChunk;
+    char *szSection;
+    int bAtomic; // write each output file as <name>.tmp and rename it when complete
+} CONVOPTS;
+
+THREAD_LOCAL FILE * ihandle;
+THREAD_LOCAL FILE * ohandle;
 void MakeC(unsigned char *, int, int);
+void WriteData(unsigned char *p, int iOffset, int iLen);
 void GetLeafName(char *fname, char *leaf);
 void FixName(char *name);
 
+uint64_t GetNanos(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+} /* GetNanos() */
+//
+// Switch the --stats timer to a new phase
+// Returns the previous phase so that it can be restored
+//
+int StatPhase(int iPhase)
+{
+    int iOld = iCurrentPhase;
+    uint64_t u64Now;
+
+    if (!bStats)
+        return iOld;
+    u64Now = GetNanos();
+    if (iCurrentPhase >= 0)
+        stats.u64Time[iCurrentPhase] += u64Now - u64PhaseStart;
+    iCurrentPhase = iPhase;
+    u64PhaseStart = u64Now;
+    return iOld;
+} /* StatPhase() */
+//
+// stdio/malloc wrappers which keep the --stats counters
+// The counters are only touched with --stats (which forces a single
+// thread), so the --info and --watch thread pools can share these
+//
+size_t StatRead(void *p, size_t size, size_t count, FILE *f)
+{
+    size_t n = fread(p, size, count, f);
+    if (bStats)
+    {
+        stats.iReads++;
+        stats.u64BytesRead += n * size;
+    }
+    return n;
+} /* StatRead() */
+
+int StatSeek(FILE *f, long lOffset, int iOrigin)
+{
+    if (bStats)
+        stats.iSeeks++;
+    return fseek(f, lOffset, iOrigin);
+} /* StatSeek() */
+
+size_t StatWrite(const void *p, size_t iLen)
+{
+    size_t n = fwrite(p, 1, iLen, ohandle);
+    if (bStats)
+    {
+        stats.iWrites++;
+        stats.u64BytesWritten += n;
+    }
+    return n;
+} /* StatWrite() */
+
+void * StatAlloc(size_t iSize)
+{
+    if (bStats)
+    {
+        stats.iAllocs++;
+        if ((int)iSize > stats.iLargestAlloc)
+            stats.iLargestAlloc = (int)iSize;
+    }
+    return malloc(iSize);
+} /* StatAlloc() */
+//
+// printf() to the output file
+//
+int OutPrintf(const char *szFormat, ...)
+{
+    char szTemp[1024];
+    va_list args;
+    int iLen, iOld;
+
+    va_start(args, szFormat);
+    iLen = vsnprintf(szTemp, sizeof(szTemp), szFormat, args);
+    va_end(args);
+    if (iLen >= (int)sizeof(szTemp))
+        iLen = sizeof(szTemp)-1;
+    iOld = StatPhase(PHASE_WRITE);
+    StatWrite(szTemp, iLen);
+    StatPhase(iOld);
+    return iLen;
+} /* OutPrintf() */
+//
+// Write the --stats results to stderr
+//
+void PrintStats(int bJSON)
+{
+    int i;
+    uint64_t u64Total = 0;
+
+    StatPhase(-1); // stop the clock
+    for (i=0; i<PHASE_COUNT; i++)
+        u64Total += stats.u64Time[i];
+    if (bJSON)
+    {
+        fprintf(stderr, "{\"time_ms\":{");
+        for (i=0; i<PHASE_COUNT; i++)
+            fprintf(stderr, "\"%s\":%.3f,", szPhase[i], stats.u64Time[i] / 1e6);
+        fprintf(stderr, "\"total\":%.3f},", u64Total / 1e6);
+        fprintf(stderr, "\"bytes_read\":%llu,\"reads\":%d,\"seeks\":%d,\"bytes_written\":%llu,\"writes\":%d,\"allocs\":%d,\"largest_alloc\":%d}\n",
+                (unsigned long long)stats.u64BytesRead, stats.iReads, stats.iSeeks,
+                (unsigned long long)stats.u64BytesWritten, stats.iWrites, stats.iAllocs, stats.iLargestAlloc);
+    }
+    else
+    {
+        fprintf(stderr, "image_to_c statistics\n");
+        for (i=0; i<PHASE_COUNT; i++)
+            fprintf(stderr, "%-12s %10.3f ms\n", szPhase[i], stats.u64Time[i] / 1e6);
+        fprintf(stderr, "%-12s %10.3f ms\n", "total", u64Total / 1e6);
+        fprintf(stderr, "bytes read    = %llu (%d reads, %d seeks)\n", (unsigned long long)stats.u64BytesRead, stats.iReads, stats.iSeeks);
+        fprintf(stderr, "bytes written = %llu (%d writes)\n", (unsigned long long)stats.u64BytesWritten, stats.iWrites);
+        fprintf(stderr, "allocations   = %d (largest = %d bytes)\n", stats.iAllocs, stats.iLargestAlloc);
+    }
+} /* PrintStats() */
+
+//
+// Prepare the tables for the chosen CRC and reset the running values
+// The CRC32C instruction (SSE4.2 or ARMv8) is used when the CPU has it
+// The tables are only built once, so after the first call this is
+// safe to use from several threads
+//
+void ChecksumInit(void)
+{
+    uint32_t u32Poly, c;
+    int i, j;
+
+    u32CRC = 0xffffffff;
+    u64Hash = 0xcbf29ce484222325ULL; // FNV-1a offset basis
+    if (iCRCType == CRC_NONE || iCRCType == iCRCTableType)
+        return;
+    u32Poly = (iCRCType == CRC_32C) ? 0x82f63b78 : 0xedb88320; // reflected
+    for (i=0; i<256; i++)
+    {
+        c = i;
+        for (j=0; j<8; j++)
+            c = (c & 1) ? (c >> 1) ^ u32Poly : (c >> 1);
+        u32CRCTable[0][i] = c;
+    }
+    for (i=0; i<256; i++)
+    {
+        for (j=1; j<8; j++)
+            u32CRCTable[j][i] = (u32CRCTable[j-1][i] >> 8) ^ u32CRCTable[0][u32CRCTable[j-1][i] & 0xff];
+    }
+    bCRCHardware = 0;
+#ifdef HAS_SSE42_CRC
+    if (iCRCType == CRC_32C && __builtin_cpu_supports("sse4.2"))
+        bCRCHardware = 1;
+#endif
+#ifdef HAS_ARM_CRC
+    bCRCHardware = 1; // ARMv8 has both polynomials
+#endif
+    iCRCTableType = iCRCType;
+} /* ChecksumInit() */
+
+#ifdef HAS_SSE42_CRC
+__attribute__((target("sse4.2")))
+uint32_t CRC32C_SSE42(uint32_t u32, const uint8_t *p, int iLen)
+{
+#ifdef __x86_64__
+    uint64_t u64 = u32, v;
+    while (iLen >= 8)
+    {
+        memcpy(&v, p, 8);
+        u64 = _mm_crc32_u64(u64, v);
+        p += 8; iLen -= 8;
+    }
+    u32 = (uint32_t)u64;
+#endif
+    while (iLen--)
+        u32 = _mm_crc32_u8(u32, *p++);
+    return u32;
+} /* CRC32C_SSE42() */
+#endif // HAS_SSE42_CRC
+
+#ifdef HAS_ARM_CRC
+uint32_t CRC32_ARM(uint32_t u32, const uint8_t *p, int iLen, int bCastagnoli)
+{
+    uint64_t v;
+    while (iLen >= 8)
+    {
+        memcpy(&v, p, 8);
+        u32 = (bCastagnoli) ? __crc32cd(u32, v) : __crc32d(u32, v);
+        p += 8; iLen -= 8;
+    }
+    while (iLen--)
+        u32 = (bCastagnoli) ? __crc32cb(u32, *p++) : __crc32b(u32, *p++);
+    return u32;
+} /* CRC32_ARM() */
+#endif // HAS_ARM_CRC
+//
+// Add a block of array data to the running CRC/hash
+//
+void ChecksumUpdate(const uint8_t *p, int iLen)
+{
+    uint32_t c = u32CRC;
+    int i, iOld;
+
+    iOld = StatPhase(PHASE_CHECKSUM);
+    if (bHash64) // FNV-1a
+    {
+        uint64_t h = u64Hash;
+        for (i=0; i<iLen; i++)
+            h = (h ^ p[i]) * 0x100000001b3ULL;
+        u64Hash = h;
+    }
+    if (iCRCType == CRC_NONE)
+        iLen = 0;
+#ifdef HAS_SSE42_CRC
+    else if (bCRCHardware)
+    {
+        c = CRC32C_SSE42(c, p, iLen);
+        iLen = 0;
+    }
+#endif
+#ifdef HAS_ARM_CRC
+    else if (bCRCHardware)
+    {
+        c = CRC32_ARM(c, p, iLen, iCRCType == CRC_32C);
+        iLen = 0;
+    }
+#endif
+    while (iLen >= 8) // slice-by-8
+    {
+        c ^= p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        c = u32CRCTable[7][c & 0xff] ^ u32CRCTable[6][(c >> 8) & 0xff] ^
+            u32CRCTable[5][(c >> 16) & 0xff] ^ u32CRCTable[4][c >> 24] ^
+            u32CRCTable[3][p[4]] ^ u32CRCTable[2][p[5]] ^
+            u32CRCTable[1][p[6]] ^ u32CRCTable[0][p[7]];
+        p += 8; iLen -= 8;
+    }
+    while (iLen--)
+        c = u32CRCTable[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+    u32CRC = c;
+    StatPhase(iOld);
+} /* ChecksumUpdate() */
+//
+// Write the checksum constants for the array
+//
+void WriteChecksums(char *szName, int iLen)
+{
+    if (iCRCType != CRC_NONE)
+        OutPrintf("const uint32_t %s_crc = 0x%08x; // %s of the %d bytes of %s\n", szName, u32CRC ^ 0xffffffff,
+                  (iCRCType == CRC_32C) ? "CRC-32C (Castagnoli)" : "CRC-32 (IEEE)", iLen, szName);
+    if (bHash64)
+        OutPrintf("const uint64_t %s_hash = 0x%016llxULL; // 64-bit FNV-1a hash of %s\n", szName, (unsigned long long)u64Hash, szName);
+} /* WriteChecksums() */
+
 unsigned short TIFFSHORT(unsigned char *p, BOOL bMotorola)
 {
     unsigned short s;
@@ -160,7 +540,7 @@ int CountGIFFrames(unsigned char *cBuf, int iFileSize)
     int bExt;
     unsigned char c;
     
-    iNumFrames = 0;
+    iNumFrames = 1; // the first frame; the loop counts the ones after it
     iOff = 10;
     c = cBuf[iOff]; // get info bits
     iOff += 3;   /* Skip flags, background color & aspect ratio */
@@ -255,9 +635,10 @@ int CountGIFFrames(unsigned char *cBuf, int iFileSize)
     
 } /* CountGIFFrames() */
 //
-// Returns the image data size
+// Probe the file header and fill in the IMAGEINFO structure
+// Returns the image data size or -1 for an unknown/invalid file
 //
-int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
+int ImageInfo(FILE *iHandle, int iFileSize, IMAGEINFO *pII)
 {
     int i, j, k;
     int iBytes;
@@ -275,12 +656,13 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
     int iDataSize = 0; // size of the compressed data
     unsigned char ucSubSample;
     BOOL bMotorola;
-    char szOptions[256];
+    char *szOptions = pII->szOptions;
     
-    szInfo[0] = 0; // start with null string
+    memset(pII, 0, sizeof(IMAGEINFO));
+    pII->iFrames = 1;
     
     // Detect the file type by its header
-    iBytes = fread(cBuf, 1, DEFAULT_READ_SIZE, iHandle);
+    iBytes = StatRead(cBuf, 1, DEFAULT_READ_SIZE, iHandle);
     if (iBytes < 64)
         return -1; // too small
     if (MOTOLONG(cBuf) == 0x89504e47) // PNG
@@ -409,8 +791,8 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
                 iHeight = 65536 - iHeight;
             iBpp = cBuf[28]; /* Number of bits per plane */
             iBpp *= cBuf[26]; /* Number of planes */
-            *iDataOff = cBuf[10]; // OffBits
-            iDataSize = iFileSize - *iDataOff;
+            pII->iDataOff = cBuf[10]; // OffBits
+            iDataSize = iFileSize - pII->iDataOff;
             if (cBuf[30] && (iBpp == 4 || iBpp == 8)) // if biCompression is non-zero (2=4bit rle, 1=8bit rle,4=24bit rle)
                 iCompression = COMPTYPE_RLE; // windows run-length
             break;
@@ -445,20 +827,20 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
         case FILETYPE_CALS:
             iBpp = 1;
             iCompression = COMPTYPE_G4;
-            fseek(iHandle, 750, SEEK_SET); // read some more
-            iBytes = fread(cBuf, 1, 1, iHandle);
+            StatSeek(iHandle, 750, SEEK_SET); // read some more
+            iBytes = StatRead(cBuf, 1, 1, iHandle);
             if (cBuf[0] == '1') // type 1 file
             {
-                fseek(iHandle, 1033, SEEK_SET); // read some more
-                iBytes = fread(cBuf, 1, 256, iHandle);
+                StatSeek(iHandle, 1033, SEEK_SET); // read some more
+                iBytes = StatRead(cBuf, 1, 256, iHandle);
                 i = 0;
                 iWidth = ParseNumber(cBuf, &i, 256);
                 iHeight = ParseNumber(cBuf, &i, 256);
             }
             else // type 2
             {
-                fseek(iHandle, 1024, SEEK_SET); // read some more
-                iBytes = fread(cBuf, 1, 128, iHandle);
+                StatSeek(iHandle, 1024, SEEK_SET); // read some more
+                iBytes = StatRead(cBuf, 1, 128, iHandle);
                 if (MOTOLONG(cBuf) == 0x7270656c && MOTOLONG(&cBuf[4]) == 0x636e743a) // "rpelcnt:"
                 {
                     i = 9;
@@ -484,7 +866,7 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
                     unsigned char cTemp[1024];
                     //               int iOff;
                     memcpy(cTemp, cBuf, 32);
-                    iBytes = fread(&cTemp[32], 1, 1024-32, iHandle);
+                    iBytes = StatRead(&cTemp[32], 1, 1024-32, iHandle);
                     bMotorola = (cTemp[i+10] == 'M');
                     // Future - do something with the thumbnail
                     //               iOff = PILTIFFLONG(&cTemp[i+14], bMotorola); // get offset to first IFD (info)
@@ -495,8 +877,8 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
                 j += 2 + MOTOSHORT(&cBuf[i+2]); /* Skip to next marker */
                 if (j < iFileSize) // need to read more
                 {
-                    fseek(iHandle, j, SEEK_SET); // read some more
-                    iBytes = fread(cBuf, 1, 32, iHandle);
+                    StatSeek(iHandle, j, SEEK_SET); // read some more
+                    iBytes = StatRead(cBuf, 1, 32, iHandle);
                     i = 0;
                 }
             } // while
@@ -525,8 +907,8 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
         case FILETYPE_TIFF:
             bMotorola = (cBuf[0] == 'M'); // determine endianness of TIFF data
             i = TIFFLONG(&cBuf[4], bMotorola); // get first IFD offset
-            fseek(iHandle, i, SEEK_SET);// read the entire tag directory
-            iBytes = fread(cBuf, 1, MAX_TAGS*TIFF_TAGSIZE, iHandle);
+            StatSeek(iHandle, i, SEEK_SET);// read the entire tag directory
+            iBytes = StatRead(cBuf, 1, MAX_TAGS*TIFF_TAGSIZE, iHandle);
             j = TIFFSHORT(cBuf, bMotorola); // get the tag count
             iOffset = 2; // point to start of TIFF tag directory
             // Some TIFF files don't specify everything, so set up some default values
@@ -559,8 +941,8 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
                         k = TIFFLONG(&cBuf[iOffset+8], bMotorola);
                         if (k < iFileSize)
                         {
-                            fseek(iHandle, k, SEEK_SET);
-                            iBytes = fread(&cBuf[iOffset], 1, 2, iHandle); // okay to overwrite the value we just used
+                            StatSeek(iHandle, k, SEEK_SET);
+                            iBytes = StatRead(&cBuf[iOffset], 1, 2, iHandle); // okay to overwrite the value we just used
                             iBpp = iCount * TIFFSHORT(&cBuf[iOffset], bMotorola);
                         }
                     }
@@ -596,7 +978,7 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
                         iPhotoMetric = 7; // unknown
                     break;
                 case 273: // strip offsets
-                    *iDataOff = TIFFVALUE(&cBuf[iOffset], bMotorola);
+                    pII->iDataOff = TIFFVALUE(&cBuf[iOffset], bMotorola);
                     break;
                 case 279: // strip byte counts
                     iDataSize = TIFFVALUE(&cBuf[iOffset], bMotorola);
@@ -612,155 +994,1334 @@ int ImageInfo(FILE *iHandle, int iFileSize, char *szInfo, int *iDataOff)
 //            sprintf(szOptions, ", Photometric = %s, Planar config = %s", szPhotometric[iPhotoMetric], szPlanar[iPlanar]);
 //            break;
     } // switch
-    sprintf(szInfo, "// %s, Compression=%s, Size: %d x %d, %d-Bpp\n", szType[iFileType], szComp[iCompression], iWidth, iHeight, iBpp);
+    pII->iFileType = iFileType;
+    pII->iCompression = iCompression;
+    pII->iWidth = iWidth;
+    pII->iHeight = iHeight;
+    pII->iBpp = iBpp;
+    pII->iDataSize = iDataSize;
     if (iFileType == FILETYPE_GIF) // see how many frames it has
     {
         // slight hack - load the file into memory
         uint8_t *pFile;
-        char szTemp[32];
-        int iFrames;
-        pFile = malloc(iFileSize);
+        int iOld = StatPhase(PHASE_GIF);
+        pFile = StatAlloc(iFileSize);
         if (pFile != NULL)
         {
-            fseek(iHandle, 0, SEEK_SET);
-            fread(pFile, 1, iFileSize, iHandle);
-            iFrames = CountGIFFrames(pFile, iFileSize);
+            StatSeek(iHandle, 0, SEEK_SET);
+            StatRead(pFile, 1, iFileSize, iHandle);
+            pII->iFrames = CountGIFFrames(pFile, iFileSize);
             free(pFile);
-            sprintf(szTemp, "// %d frames\n//\n", iFrames);
-            strcat(szInfo, szTemp);
         }
+        StatPhase(iOld);
+    }
+    return iDataSize;
+} /* ImageInfo() */
+//
+// Format the image info as a C comment block
+//
+void GetInfoString(IMAGEINFO *pII, char *szInfo)
+{
+    char szTemp[32];
+
+    sprintf(szInfo, "// %s, Compression=%s, Size: %d x %d, %d-Bpp\n", szType[pII->iFileType], szComp[pII->iCompression], pII->iWidth, pII->iHeight, pII->iBpp);
+    if (pII->iFileType == FILETYPE_GIF)
+    {
+        // this comment has always shown one less than the real frame count;
+        // keep it that way so that existing headers don't change
+        sprintf(szTemp, "// %d frames\n//\n", pII->iFrames - 1);
+        strcat(szInfo, szTemp);
     }
     else
     {
         strcat(szInfo, "//\n"); // simple end of comment
     }
-    return iDataSize;
-} /* ImageInfo() */
+} /* GetInfoString() */
+//
+// Collect the files to probe for --info
+//
+static PROBERECORD *pRecords = NULL;
+static int iRecordCount = 0, iRecordMax = 0;
+static int iNextRecord = 0;
+static int bWalkDone = 0; // no more files will be added
+#ifndef _WIN32
+static pthread_mutex_t probeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probeCond = PTHREAD_COND_INITIALIZER;
+#endif
+//
+// Add a file to the list; the probe threads are already working on it
+//
+void AddProbeFile(const char *szName)
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&probeMutex);
+#endif
+    if (iRecordCount == iRecordMax) // grow the list
+    {
+        iRecordMax = (iRecordMax) ? iRecordMax * 2 : 1024;
+        pRecords = (PROBERECORD *)realloc(pRecords, iRecordMax * sizeof(PROBERECORD));
+        if (pRecords == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+    memset(&pRecords[iRecordCount], 0, sizeof(PROBERECORD));
+    pRecords[iRecordCount++].szName = strdup(szName);
+#ifndef _WIN32
+    pthread_cond_signal(&probeCond);
+    pthread_mutex_unlock(&probeMutex);
+#endif
+} /* AddProbeFile() */
+//
+// Add a file or (recursively) the contents of a directory to the probe list
+//
+void WalkPath(const char *szPath)
+{
+    char szName[MAX_PATH_LEN];
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    HANDLE hFind;
+    DWORD dwAttr;
+
+    dwAttr = GetFileAttributesA(szPath);
+    if (dwAttr == INVALID_FILE_ATTRIBUTES)
+    {
+        fprintf(stderr, "Unable to open: %s\n", szPath);
+        return;
+    }
+    if (!(dwAttr & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        AddProbeFile(szPath);
+        return;
+    }
+    snprintf(szName, sizeof(szName), "%s%c*", szPath, PILIO_SLASH_CHAR);
+    hFind = FindFirstFileA(szName, &fd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (fd.cFileName[0] == '.') // skip ., .. and hidden files
+            continue;
+        snprintf(szName, sizeof(szName), "%s%c%s", szPath, PILIO_SLASH_CHAR, fd.cFileName);
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            WalkPath(szName);
+        else
+            AddProbeFile(szName);
+    } while (FindNextFileA(hFind, &fd));
+    FindClose(hFind);
+#else
+    struct stat st;
+    struct dirent *pEntry;
+    DIR *pDir;
+
+    if (lstat(szPath, &st) != 0)
+    {
+        fprintf(stderr, "Unable to open: %s\n", szPath);
+        return;
+    }
+    if (S_ISLNK(st.st_mode)) // follow links to files, but not to directories (avoids loops)
+    {
+        if (stat(szPath, &st) == 0 && S_ISREG(st.st_mode))
+            AddProbeFile(szPath);
+        return;
+    }
+    if (S_ISREG(st.st_mode))
+    {
+        AddProbeFile(szPath);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return; // skip devices, sockets, etc
+    pDir = opendir(szPath);
+    if (pDir == NULL)
+    {
+        fprintf(stderr, "Unable to open: %s\n", szPath);
+        return;
+    }
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if (pEntry->d_name[0] == '.') // skip ., .. and hidden files
+            continue;
+        snprintf(szName, sizeof(szName), "%s%c%s", szPath, PILIO_SLASH_CHAR, pEntry->d_name);
+        WalkPath(szName);
+    }
+    closedir(pDir);
+#endif
+} /* WalkPath() */
+//
+// Run the header probe on a single file
+//
+void ProbeFile(PROBERECORD *pRec)
+{
+    FILE *f;
+
+    StatPhase(PHASE_OPEN);
+    f = fopen(pRec->szName, "rb");
+    if (f == NULL)
+    {
+        pRec->iResult = -2; // unreadable
+        return;
+    }
+    StatSeek(f, 0L, SEEK_END);
+    pRec->iFileSize = (int)ftell(f);
+    StatSeek(f, 0, SEEK_SET);
+    StatPhase(PHASE_PROBE);
+    pRec->iResult = ImageInfo(f, pRec->iFileSize, &pRec->ii);
+    StatPhase(PHASE_OPEN);
+    fclose(f);
+    StatPhase(PHASE_OTHER);
+} /* ProbeFile() */
+//
+// Worker thread; keep grabbing the next unprobed file until the walk
+// is finished and the list is empty. The list can be reallocated by the
+// walk, so each file is probed into a local copy.
+//
+void * ProbeThread(void *pUnused)
+{
+    int i;
+    PROBERECORD rec;
+
+    (void)pUnused;
+    while (1)
+    {
+#ifndef _WIN32
+        pthread_mutex_lock(&probeMutex);
+        while (iNextRecord >= iRecordCount && !bWalkDone)
+            pthread_cond_wait(&probeCond, &probeMutex);
+#endif
+        if (iNextRecord >= iRecordCount)
+        {
+#ifndef _WIN32
+            pthread_mutex_unlock(&probeMutex);
+#endif
+            break;
+        }
+        i = iNextRecord++;
+        rec = pRecords[i];
+#ifndef _WIN32
+        pthread_mutex_unlock(&probeMutex);
+#endif
+        ProbeFile(&rec);
+#ifndef _WIN32
+        pthread_mutex_lock(&probeMutex);
+#endif
+        pRecords[i] = rec;
+#ifndef _WIN32
+        pthread_mutex_unlock(&probeMutex);
+#endif
+    }
+    return NULL;
+} /* ProbeThread() */
+
+int CompareRecords(const void *p1, const void *p2)
+{
+    return strcmp(((const PROBERECORD *)p1)->szName, ((const PROBERECORD *)p2)->szName);
+} /* CompareRecords() */
+//
+// Write a string with the characters JSON doesn't allow escaped
+//
+void PrintJSONString(const char *s)
+{
+    putchar('"');
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char)*s < ' ')
+            printf("\\u%04x", (unsigned char)*s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+} /* PrintJSONString() */
+//
+// Write a CSV field, quoting it if needed
+//
+void PrintCSVString(const char *s)
+{
+    if (strpbrk(s, ",\"\r\n") == NULL)
+    {
+        printf("%s", s);
+        return;
+    }
+    putchar('"');
+    for (; *s; s++)
+    {
+        if (*s == '"')
+            putchar('"'); // double the quotes
+        putchar(*s);
+    }
+    putchar('"');
+} /* PrintCSVString() */
+//
+// Print one manifest record as JSON-lines or CSV
+//
+void PrintRecord(PROBERECORD *pRec, int bCSV)
+{
+    IMAGEINFO *pII = &pRec->ii;
+    const char *szStatus;
+    int iStrippable = 0;
+
+    if (pRec->iResult == -2)
+        szStatus = "unreadable";
+    else if (pRec->iResult < 0)
+        szStatus = "unknown";
+    else
+        szStatus = "ok";
+    if (pII->iDataSize > 0 && pII->iDataSize < pRec->iFileSize)
+        iStrippable = pRec->iFileSize - pII->iDataSize; // bytes saved by --strip
+    if (bCSV)
+    {
+        PrintCSVString(pRec->szName);
+        printf(",%s,%s,%s,%d,%d,%d,%d,%d,%d,%d,%d\n", szStatus, szType[pII->iFileType], szComp[pII->iCompression], pII->iWidth, pII->iHeight, pII->iBpp, pII->iFrames, pRec->iFileSize, pII->iDataOff, pII->iDataSize, iStrippable);
+    }
+    else
+    {
+        printf("{\"file\":");
+        PrintJSONString(pRec->szName);
+        printf(",\"status\":\"%s\",\"type\":\"%s\",\"compression\":\"%s\",\"width\":%d,\"height\":%d,\"bpp\":%d,\"frames\":%d,\"file_size\":%d,\"data_offset\":%d,\"data_size\":%d,\"strippable\":%d}\n", szStatus, szType[pII->iFileType], szComp[pII->iCompression], pII->iWidth, pII->iHeight, pII->iBpp, pII->iFrames, pRec->iFileSize, pII->iDataOff, pII->iDataSize, iStrippable);
+    }
+} /* PrintRecord() */
+//
+// --info mode
+// Walk the given files/directories and write a manifest to stdout
+// (sorted by name so it can be diffed). The walk runs on the main
+// thread while the other threads probe the files it has found so far;
+// once the walk is done the main thread helps with the probing.
+// Windows builds walk and probe on a single thread.
+//
+int ProbeFiles(int argc, char *argv[], int iStart, int bCSV, int iThreads)
+{
+    int i;
+#ifdef _WIN32
+    (void)iThreads;
+    for (i=iStart; i<argc; i++)
+        WalkPath(argv[i]);
+    bWalkDone = 1;
+    ProbeThread(NULL);
+#else
+    pthread_t tid[MAX_THREADS];
+
+    if (iThreads <= 0)
+        iThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (iThreads > MAX_THREADS)
+        iThreads = MAX_THREADS;
+    for (i=1; i<iThreads; i++) // the main thread is worker #0
+    {
+        if (pthread_create(&tid[i], NULL, ProbeThread, NULL) != 0)
+            break;
+    }
+    iThreads = i;
+    for (i=iStart; i<argc; i++)
+        WalkPath(argv[i]);
+    pthread_mutex_lock(&probeMutex);
+    bWalkDone = 1;
+    pthread_cond_broadcast(&probeCond);
+    pthread_mutex_unlock(&probeMutex);
+    ProbeThread(NULL);
+    for (i=1; i<iThreads; i++)
+        pthread_join(tid[i], NULL);
+#endif
+    if (iRecordCount)
+        qsort(pRecords, iRecordCount, sizeof(PROBERECORD), CompareRecords);
+    if (bCSV)
+        printf("file,status,type,compression,width,height,bpp,frames,file_size,data_offset,data_size,strippable\n");
+    for (i=0; i<iRecordCount; i++)
+    {
+        PrintRecord(&pRecords[i], bCSV);
+        free(pRecords[i].szName);
+    }
+    free(pRecords);
+    return 0;
+} /* ProbeFiles() */
+//
+// Build the attributes for an array declaration
+// PROGMEM is itself a section on AVR, so it's dropped when a section is given
+//
+void GetAttributes(char *szAttr, int iAlign, const char *szSection)
+{
+    if (szSection == NULL)
+        strcpy(szAttr, " PROGMEM");
+    else
+        szAttr[0] = 0;
+    if (iAlign > 1 && szSection)
+        sprintf(&szAttr[strlen(szAttr)], " __attribute__((aligned(%d), section(\"%s\")))", iAlign, szSection);
+    else if (iAlign > 1)
+        sprintf(&szAttr[strlen(szAttr)], " __attribute__((aligned(%d)))", iAlign);
+    else if (szSection)
+        sprintf(&szAttr[strlen(szAttr)], " __attribute__((section(\"%s\")))", szSection);
+} /* GetAttributes() */
+//
+// --dma-chunk
+// Write a linked list of descriptors which covers the array in pieces
+// of iChunk bytes. The array is aligned to iChunk (or to the next power
+// of 2 above its size if that is smaller), so no piece crosses an iChunk
+// address boundary.
+//
+void WriteDMATable(char *szName, int iDataLen, int iChunk)
+{
+    int i, iChunks;
+
+    iChunks = (iDataLen + iChunk - 1) / iChunk;
+    if (iChunks == 0)
+        iChunks = 1;
+    OutPrintf("#ifndef IMAGE_TO_C_DMA_DESC\n#define IMAGE_TO_C_DMA_DESC\n");
+    OutPrintf("typedef struct image_to_c_dma_desc\n{\n");
+    OutPrintf("    const uint8_t *pSrc;\n    uint32_t u32Len;\n");
+    OutPrintf("    const struct image_to_c_dma_desc *pNext; // 0 = end of the list\n");
+    OutPrintf("} image_to_c_dma_desc;\n#endif\n");
+    OutPrintf("#define %s_DMA_CHUNKS %d\n", szName, iChunks);
+    OutPrintf("const image_to_c_dma_desc %s_dma[%s_DMA_CHUNKS] = {\n", szName, szName);
+    for (i=0; i<iChunks; i++)
+    {
+        int iLen = iDataLen - i*iChunk;
+        if (iLen > iChunk)
+            iLen = iChunk;
+        if (i == iChunks-1)
+            OutPrintf("\t{&%s[%d], %d, 0}\n", szName, i*iChunk, iLen);
+        else
+            OutPrintf("\t{&%s[%d], %d, &%s_dma[%d]},\n", szName, i*iChunk, iLen, szName, i+1);
+    }
+    OutPrintf("};\n");
+} /* WriteDMATable() */
+//
+// Create an output file; with bAtomic it is written as <name>.tmp
+// and only renamed to <name> by CloseOutput()
+//
+FILE * OpenOutput(const char *szName, int bAtomic)
+{
+    char szTemp[MAX_PATH_LEN+8];
+    FILE *f;
+
+    StatPhase(PHASE_OPEN);
+    if (bAtomic)
+    {
+        snprintf(szTemp, sizeof(szTemp), "%s.tmp", szName);
+        f = fopen(szTemp, "wb");
+    }
+    else
+        f = fopen(szName, "wb");
+    StatPhase(PHASE_OTHER);
+    return f;
+} /* OpenOutput() */
+//
+// Close a file from OpenOutput(); a temporary file replaces <name> if
+// everything succeeded (bOK) and is removed otherwise, so that anything
+// watching the output never sees a partial file
+// Returns 0 for success, -1 for an error
+//
+int CloseOutput(FILE *f, const char *szName, int bAtomic, int bOK)
+{
+    char szTemp[MAX_PATH_LEN+8];
+    int rc;
+
+    StatPhase(PHASE_WRITE);
+    rc = (fclose(f) == 0) ? 0 : -1;
+    StatPhase(PHASE_OTHER);
+    if (!bAtomic)
+        return rc;
+    snprintf(szTemp, sizeof(szTemp), "%s.tmp", szName);
+    if (rc == 0 && bOK && rename(szTemp, szName) == 0)
+        return 0;
+    remove(szTemp);
+    return -1;
+} /* CloseOutput() */
+//
+// --shard mode
+// Split the array into shards of iShardSize bytes, each in its own .c file
+// (szOut_0.c, szOut_1.c...) so that they can be compiled in parallel.
+// The header (already open as ohandle) declares the shards and shard 0
+// holds a table of pointers to them. With bSection, each shard is also
+// placed in its own section (<section>.<name>.nnnn, default .rodata) so
+// that a linker script can place them back to back.
+//
+int WriteShards(unsigned char *p, char *szName, char *szOut, int iDataStart, int iDataLen, int iShardSize, int bSection, int iAlign, const char *szSection, int bAtomic)
+{
+    int i, iShards, iLen, rc = 0;
+    char szGuard[256], szFile[MAX_PATH_LEN], szHeader[260], szBase[256];
+    char szShardSection[256], szAttr[512];
+    const char *szBaseSection = (szSection) ? szSection : ".rodata";
+    FILE *oHeader = ohandle, *oShard0 = NULL;
+
+    iShards = (iDataLen + iShardSize - 1) / iShardSize;
+    if (iShards == 0)
+        iShards = 1;
+    // the header is szOut.h, so keep any dots in the prefix (gen/big.v2 -> big.v2.h)
+    for (i=(int)strlen(szOut)-1; i>=0; i--)
+    {
+        if (szOut[i] == '\\' || szOut[i] == '/') // Windows or Linux
+            break;
+    }
+    strncpy(szBase, &szOut[i+1], sizeof(szBase)-1);
+    szBase[sizeof(szBase)-1] = 0;
+    sprintf(szHeader, "%s.h", szBase);
+    strcpy(szGuard, szBase);
+    FixName(szGuard);
+    for (i=0; szGuard[i]; i++)
+        szGuard[i] = toupper((unsigned char)szGuard[i]);
+    strcat(szGuard, "_H");
+    OutPrintf("// Split into %d shards of %d bytes (%s_0.c - %s_%d.c)\n//\n", iShards, iShardSize, szBase, szBase, iShards-1);
+    if (bSection)
+    {
+        OutPrintf("// Each shard is in its own section; to keep them contiguous add this\n");
+        OutPrintf("// to the read-only data in your linker script:\n");
+        OutPrintf("//   KEEP(*(SORT_BY_NAME(%s.%s.*)))\n//\n", szBaseSection, szName);
+    }
+    OutPrintf("#ifndef %s\n#define %s\n", szGuard, szGuard);
+    OutPrintf("#include <stdint.h>\n");
+    OutPrintf("// for non-Arduino builds...\n");
+    OutPrintf("#ifndef PROGMEM\n#define PROGMEM\n#endif\n");
+    OutPrintf("#define %s_SIZE %d\n", szName, iDataLen);
+    OutPrintf("#define %s_SHARDS %d\n", szName, iShards);
+    OutPrintf("#define %s_SHARD_SIZE %d\n", szName, iShardSize);
+    OutPrintf("#define %s_SHARD_LEN(i) (((i) == %s_SHARDS-1) ? (%s_SIZE - (i)*%s_SHARD_SIZE) : %s_SHARD_SIZE)\n", szName, szName, szName, szName, szName);
+    for (i=0; i<iShards; i++)
+    {
+        snprintf(szShardSection, sizeof(szShardSection), "%s.%s.%04d", szBaseSection, szName, i);
+        GetAttributes(szAttr, iAlign, (bSection) ? szShardSection : szSection);
+        OutPrintf("extern const uint8_t %s_%d[]%s;\n", szName, i, szAttr);
+    }
+    OutPrintf("extern const uint8_t * const %s_shards[%s_SHARDS];\n", szName, szName);
+    if (iCRCType != CRC_NONE)
+        OutPrintf("extern const uint32_t %s_crc;\n", szName);
+    if (bHash64)
+        OutPrintf("extern const uint64_t %s_hash;\n", szName);
+    if (bSection)
+        OutPrintf("#define %s %s_0 // the whole image, only valid with the linker script above\n", szName, szName);
+    OutPrintf("#endif // %s\n", szGuard);
+    for (i=0; i<iShards; i++)
+    {
+        snprintf(szFile, sizeof(szFile), "%s_%d.c", szOut, i);
+        ohandle = OpenOutput(szFile, bAtomic);
+        if (ohandle == NULL)
+        {
+            fprintf(stderr, "Unable to create file: %s\n", szFile);
+            rc = -1;
+            break;
+        }
+        iLen = iDataLen - i*iShardSize;
+        if (iLen > iShardSize)
+            iLen = iShardSize;
+        OutPrintf("// Created with image_to_c\n// https://github.com/bitbank2/image_to_c\n");
+        OutPrintf("//\n// %s shard %d of %d, bytes %d-%d\n//\n", szName, i, iShards, i*iShardSize, i*iShardSize + iLen - 1);
+        OutPrintf("#include \"%s\"\n", szHeader);
+        snprintf(szShardSection, sizeof(szShardSection), "%s.%s.%04d", szBaseSection, szName, i);
+        GetAttributes(szAttr, iAlign, (bSection) ? szShardSection : szSection);
+        OutPrintf("const uint8_t %s_%d[]%s = {\n", szName, i, szAttr);
+        WriteData(p, iDataStart + i*iShardSize, iLen);
+        OutPrintf("};\n");
+        if (i == 0) // the table of shards lives with the first one
+        {
+            int j;
+            OutPrintf("const uint8_t * const %s_shards[%s_SHARDS] = {\n", szName, szName);
+            for (j=0; j<iShards; j++)
+                OutPrintf("\t%s_%d%s\n", szName, j, (j == iShards-1) ? "" : ",");
+            OutPrintf("};\n");
+            oShard0 = ohandle; // stays open for the checksums
+            continue;
+        }
+        if (CloseOutput(ohandle, szFile, bAtomic, 1) != 0)
+            rc = -1;
+    }
+    if (oShard0 != NULL)
+    {
+        ohandle = oShard0;
+        if (rc == 0) // now that all of the data has been seen
+            WriteChecksums(szName, iDataLen);
+        snprintf(szFile, sizeof(szFile), "%s_0.c", szOut);
+        if (CloseOutput(oShard0, szFile, bAtomic, rc == 0) != 0)
+            rc = -1;
+    }
+    ohandle = oHeader;
+    return rc;
+} /* WriteShards() */
+//
+// Convert one image file to C
+// The output goes to pOutName (or the shard prefix) or stdout if NULL
+// p is a 64k work buffer
+// Returns 0 for success, 1 if skipped (bKnownOnly and not an image) or -1 for an error
+//
+int ConvertFile(const char *szIn, const char *pOutName, CONVOPTS *pOpts, unsigned char *p, int bKnownOnly)
+{
+    int iSize, iData;
+    int iDataOff, iDataSize;
+    int iAlign, iDMAAlign;
+    int bStrip = pOpts->bStrip;
+    char szLeaf[256];
+    char szInfo[MAX_PATH_LEN];
+    char szOut[MAX_PATH_LEN];
+    char szOutFile[MAX_PATH_LEN];
+    char szAttr[512];
+    IMAGEINFO ii;
+
+    StatPhase(PHASE_OPEN);
+    ihandle = fopen(szIn, "rb"); // open input file
+    if (ihandle == NULL)
+    {
+        fprintf(stderr, "Unable to open file: %s\n", szIn);
+        return -1; // bad filename passed
+    }
+    StatSeek(ihandle, 0L, SEEK_END); // get the file size
+    iSize = (int)ftell(ihandle);
+    StatSeek(ihandle, 0, SEEK_SET);
+    StatPhase(PHASE_PROBE);
+    szInfo[0] = 0;
+    iDataSize = ImageInfo(ihandle, iSize, &ii); // get image info
+    if (iDataSize >= 0)
+        GetInfoString(&ii, szInfo);
+    else if (bKnownOnly)
+    {
+        fclose(ihandle);
+        return 1;
+    }
+    iDataOff = ii.iDataOff;
+    StatPhase(PHASE_OPEN);
+    ohandle = stdout;
+    if (pOutName)
+    {
+        strncpy(szOut, pOutName, sizeof(szOut)-3);
+        szOut[sizeof(szOut)-3] = 0;
+        if (pOpts->iShardSize) // the name is the prefix for the shards
+        {
+            iData = (int)strlen(szOut);
+            if (iData > 2 && strcmp(&szOut[iData-2], ".h") == 0)
+                szOut[iData-2] = 0;
+            snprintf(szOutFile, sizeof(szOutFile), "%s.h", szOut);
+        }
+        else
+        {
+            strcpy(szOutFile, szOut);
+        }
+        ohandle = OpenOutput(szOutFile, pOpts->bAtomic);
+        if (ohandle == NULL)
+        {
+            fprintf(stderr, "Unable to create file: %s\n", pOutName);
+            fclose(ihandle);
+            ohandle = stdout;
+            return -1;
+        }
+    }
+    StatPhase(PHASE_OTHER);
+    GetLeafName((char *)szIn, szLeaf);
+    OutPrintf("// Created with image_to_c\n// https://github.com/bitbank2/image_to_c\n");
+    if (bStrip && iDataSize > 0 && iDataOff != iDataSize) {
+       OutPrintf("//\n// This hex data is only the image; the header + metadata has been removed\n");
+       OutPrintf("// %s\n// File size = %d bytes, this data = %d bytes\n//\n", szLeaf, iSize, iDataSize); 
+    } else {
+       bStrip = 0; // disable stripping if not possible to use it
+       iDataOff = 0;
+       iDataSize = iSize;
+       OutPrintf("//\n// %s\n// Data size = %d bytes\n//\n", szLeaf, iSize); // comment header with filename
+    }
+    if (szInfo[0])
+        OutPrintf("%s", szInfo);
+    FixName(szLeaf); // remove unusable characters
+    ChecksumInit();
+    iData = 0;
+    if (pOpts->iShardSize)
+    {
+        iData = WriteShards(p, szLeaf, szOut, iDataOff, iDataSize, pOpts->iShardSize, pOpts->bShardSection, pOpts->iAlign, pOpts->szSection, pOpts->bAtomic);
+    }
+    else
+    {
+        OutPrintf("// for non-Arduino builds...\n");
+        OutPrintf("#ifndef PROGMEM\n#define PROGMEM\n#endif\n");
+        iAlign = pOpts->iAlign;
+        if (pOpts->iDMAChunk)
+        { // an array smaller than a chunk only needs to sit inside one block of its own (power of 2) size
+            for (iDMAAlign = 1; iDMAAlign < iDataSize && iDMAAlign < pOpts->iDMAChunk; iDMAAlign <<= 1)
+                ;
+            if (iAlign < iDMAAlign)
+                iAlign = iDMAAlign;
+        }
+        GetAttributes(szAttr, iAlign, pOpts->szSection);
+        OutPrintf("const uint8_t %s[]%s = {\n", szLeaf, szAttr); // start of data array
+        WriteData(p, iDataOff, iDataSize);
+        OutPrintf("};\n"); // final closing brace
+        WriteChecksums(szLeaf, iDataSize);
+        if (pOpts->iDMAChunk)
+            WriteDMATable(szLeaf, iDataSize, pOpts->iDMAChunk);
+    }
+    StatPhase(PHASE_OTHER);
+    fclose(ihandle);
+    if (ohandle != stdout)
+    {
+        if (CloseOutput(ohandle, szOutFile, pOpts->bAtomic, iData == 0) != 0)
+            iData = -1;
+        ohandle = stdout;
+    }
+    return iData;
+} /* ConvertFile() */
+#ifdef __linux__
+//
+// --watch mode
+// Convert everything once, then use inotify to catch changes. Bursts of
+// events are collected until things are quiet for WATCH_DEBOUNCE_MS and
+// then only the changed files are converted by a pool of threads which
+// (along with their buffers) stay alive between events.
+// Each file is written to the same relative path under the output
+// directory that it has under the directory being watched
+// (assets/ui/icon.png -> <output dir>/ui/icon.h).
+//
+typedef struct tag_filelist
+{
+    char **pNames;
+    char **pOutNames; // output name relative to the output directory, without the extension
+    int iCount, iMax;
+} FILELIST;
+
+typedef struct tag_watchdir
+{
+    int wd; // inotify watch descriptor
+    char *szPath;
+    char *szOut; // matching directory under the output directory ("" for the top)
+    int bNamedOnly; // only watched for the files named on the command line
+    FILELIST named; // those files (leaf names)
+} WATCHDIR;
+
+static WATCHDIR *pWatchDirs = NULL;
+static int iWatchCount = 0, iWatchMax = 0;
+static FILELIST jobs; // the batch being converted
+static FILELIST claims; // which input file owns each output name
+static int iNextJob = 0, iJobsDone = 0;
+static char *szWatchOut;
+static struct stat stWatchOut; // to recognize the output directory if it's inside a watched one
+static CONVOPTS *pWatchOpts;
+static pthread_mutex_t jobMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+
+//
+// Add a name and its output name to the list (once)
+//
+void AddFileList(FILELIST *pList, const char *szName, const char *szOutName)
+{
+    int i;
+
+    for (i=0; i<pList->iCount; i++)
+    {
+        if (strcmp(pList->pNames[i], szName) == 0)
+            return; // already there
+    }
+    if (pList->iCount == pList->iMax)
+    {
+        pList->iMax = (pList->iMax) ? pList->iMax * 2 : 64;
+        pList->pNames = (char **)realloc(pList->pNames, pList->iMax * sizeof(char *));
+        pList->pOutNames = (char **)realloc(pList->pOutNames, pList->iMax * sizeof(char *));
+        if (pList->pNames == NULL || pList->pOutNames == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+    pList->pNames[pList->iCount] = strdup(szName);
+    pList->pOutNames[pList->iCount++] = strdup(szOutName);
+} /* AddFileList() */
+
+void FreeFileList(FILELIST *pList)
+{
+    int i;
+
+    for (i=0; i<pList->iCount; i++)
+    {
+        free(pList->pNames[i]);
+        free(pList->pOutNames[i]);
+    }
+    pList->iCount = 0;
+} /* FreeFileList() */
+//
+// Skip hidden files and editor backups
+//
+int IgnoreName(const char *szName)
+{
+    int iLen = (int)strlen(szName);
+    return (szName[0] == '.' || iLen == 0 || szName[iLen-1] == '~');
+} /* IgnoreName() */
+//
+// Create a directory and any missing parents (like mkdir -p)
+// Returns 0 if it exists afterwards, -1 if not
+//
+int MakeDirs(const char *szPath)
+{
+    char szTemp[MAX_PATH_LEN];
+    struct stat st;
+    int i;
+
+    strncpy(szTemp, szPath, sizeof(szTemp)-1);
+    szTemp[sizeof(szTemp)-1] = 0;
+    for (i=1; szTemp[i]; i++)
+    {
+        if (szTemp[i] == '/')
+        {
+            szTemp[i] = 0;
+            mkdir(szTemp, 0755); // it's fine if it's already there
+            szTemp[i] = '/';
+        }
+    }
+    mkdir(szTemp, 0755);
+    if (stat(szTemp, &st) != 0 || !S_ISDIR(st.st_mode))
+        return -1;
+    return 0;
+} /* MakeDirs() */
+//
+// Add a changed file to the list unless its output belongs to another
+// file (e.g. icon.bmp and icon.png in the same directory, or two
+// watched directories with the same layout); the first one keeps it
+//
+void QueueFile(FILELIST *pList, const char *szIn, const char *szOutName)
+{
+    int i;
+
+    for (i=0; i<claims.iCount; i++)
+    {
+        if (strcmp(claims.pOutNames[i], szOutName) == 0)
+        {
+            if (strcmp(claims.pNames[i], szIn) == 0)
+                break;
+            fprintf(stderr, "Skipping %s: %s/%s.h is already written by %s\n", szIn, szWatchOut, szOutName, claims.pNames[i]);
+            return;
+        }
+        if (strcmp(claims.pNames[i], szIn) == 0) // reached by another path
+            return;
+    }
+    if (i == claims.iCount)
+        AddFileList(&claims, szIn, szOutName);
+    AddFileList(pList, szIn, szOutName);
+} /* QueueFile() */
+//
+// Start watching a directory (or find the existing watch)
+// Returns the index in pWatchDirs, -1 for an error; *pbNew tells if it was new
+//
+int AddWatchDir(int fd, const char *szPath, const char *szOut, int *pbNew)
+{
+    int i, wd;
+
+    *pbNew = 0;
+    wd = inotify_add_watch(fd, szPath, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF);
+    if (wd < 0)
+    {
+        fprintf(stderr, "Unable to watch: %s\n", szPath);
+        return -1;
+    }
+    for (i=0; i<iWatchCount; i++)
+    {
+        if (pWatchDirs[i].wd == wd) // already watched
+            return i;
+    }
+    if (iWatchCount == iWatchMax)
+    {
+        iWatchMax = (iWatchMax) ? iWatchMax * 2 : 64;
+        pWatchDirs = (WATCHDIR *)realloc(pWatchDirs, iWatchMax * sizeof(WATCHDIR));
+        if (pWatchDirs == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+    memset(&pWatchDirs[iWatchCount], 0, sizeof(WATCHDIR));
+    pWatchDirs[iWatchCount].wd = wd;
+    pWatchDirs[iWatchCount].szPath = strdup(szPath);
+    pWatchDirs[iWatchCount].szOut = strdup(szOut);
+    *pbNew = 1;
+    return iWatchCount++;
+} /* AddWatchDir() */
+//
+// Watch a directory (and its subdirectories) and add the files in it to the list
+// szOut is the matching path under the output directory
+//
+void WatchPath(int fd, const char *szPath, const char *szOut, FILELIST *pList)
+{
+    char szName[MAX_PATH_LEN], szOutName[MAX_PATH_LEN], *d;
+    struct stat st;
+    struct dirent *pEntry;
+    DIR *pDir;
+    int i, bNew;
+
+    if (stat(szPath, &st) != 0)
+        return;
+    if (S_ISREG(st.st_mode))
+    {
+        strcpy(szOutName, szOut);
+        d = strrchr(szOutName, '.'); // remove the filename extension
+        if (d != NULL && strchr(d, '/') == NULL)
+            *d = 0;
+        QueueFile(pList, szPath, szOutName);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return;
+    if (st.st_dev == stWatchOut.st_dev && st.st_ino == stWatchOut.st_ino)
+        return; // our own output (e.g. --watch gen .), don't convert it to itself
+    i = AddWatchDir(fd, szPath, szOut, &bNew);
+    if (i < 0 || (!bNew && !pWatchDirs[i].bNamedOnly)) // already walked
+        return;
+    if (!bNew) // was only watched for some files, now it's the whole thing
+    {
+        pWatchDirs[i].bNamedOnly = 0;
+        free(pWatchDirs[i].szOut);
+        pWatchDirs[i].szOut = strdup(szOut);
+    }
+    if (szOut[0])
+    {
+        snprintf(szName, sizeof(szName), "%s/%s", szWatchOut, szOut);
+        mkdir(szName, 0755);
+    }
+    pDir = opendir(szPath);
+    if (pDir == NULL)
+        return;
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if (IgnoreName(pEntry->d_name)) // also skips . and ..
+            continue;
+        snprintf(szName, sizeof(szName), "%s/%s", szPath, pEntry->d_name);
+        if (szOut[0])
+            snprintf(szOutName, sizeof(szOutName), "%s/%s", szOut, pEntry->d_name);
+        else
+            snprintf(szOutName, sizeof(szOutName), "%s", pEntry->d_name);
+        WatchPath(fd, szName, szOutName, pList);
+    }
+    closedir(pDir);
+} /* WatchPath() */
+//
+// Watch a single file named on the command line
+// inotify can only follow it through its directory, so the directory is
+// watched and events for its other files are ignored
+//
+void WatchFile(int fd, const char *szPath, FILELIST *pList)
+{
+    char szDir[MAX_PATH_LEN], szName[MAX_PATH_LEN], szOutName[256];
+    const char *szLeaf;
+    int i, bNew;
+
+    szLeaf = strrchr(szPath, '/');
+    if (szLeaf == NULL)
+    {
+        strcpy(szDir, ".");
+        szLeaf = szPath;
+    }
+    else
+    {
+        i = (int)(szLeaf - szPath);
+        if (i == 0) // file in the root directory
+            i = 1;
+        memcpy(szDir, szPath, i);
+        szDir[i] = 0;
+        szLeaf++;
+    }
+    i = AddWatchDir(fd, szDir, "", &bNew);
+    if (i < 0)
+        return;
+    if (bNew)
+        pWatchDirs[i].bNamedOnly = 1;
+    GetLeafName((char *)szLeaf, szOutName);
+    if (pWatchDirs[i].bNamedOnly)
+        AddFileList(&pWatchDirs[i].named, szLeaf, szOutName);
+    else
+        return; // the whole directory is already being watched
+    snprintf(szName, sizeof(szName), "%s/%s", pWatchDirs[i].szPath, szLeaf); // the same name the events will use
+    QueueFile(pList, szName, szOutName);
+} /* WatchFile() */
+//
+// Convert one file of the batch to <output dir>/<output name>.h
+// (or the shards of it); every file is written to a temporary name and
+// renamed, so anything watching the output never sees a partial file
+//
+void WatchConvert(const char *szIn, const char *szOutName, unsigned char *p)
+{
+    char szOut[MAX_PATH_LEN];
+    uint64_t u64Start = GetNanos();
+    int rc;
+
+    if (pWatchOpts->iShardSize)
+        snprintf(szOut, sizeof(szOut), "%s/%s", szWatchOut, szOutName);
+    else
+        snprintf(szOut, sizeof(szOut), "%s/%s.h", szWatchOut, szOutName);
+    rc = ConvertFile(szIn, szOut, pWatchOpts, p, 1);
+    if (rc == 0)
+        fprintf(stderr, "%s -> %s (%.1f ms)\n", szIn, szOut, (GetNanos() - u64Start) / 1e6);
+    else if (rc < 0)
+        fprintf(stderr, "Unable to convert: %s\n", szIn);
+} /* WatchConvert() */
+//
+// Worker thread; sleeps until there is a batch to convert
+//
+void * WatchThread(void *pUnused)
+{
+    unsigned char *p;
+    int i;
+
+    (void)pUnused;
+    p = (unsigned char *)malloc(0x10000); // kept for the life of the thread
+    if (p == NULL)
+        return NULL;
+    pthread_mutex_lock(&jobMutex);
+    while (1)
+    {
+        while (iNextJob >= jobs.iCount)
+            pthread_cond_wait(&jobCond, &jobMutex);
+        i = iNextJob++;
+        pthread_mutex_unlock(&jobMutex);
+        WatchConvert(jobs.pNames[i], jobs.pOutNames[i], p);
+        pthread_mutex_lock(&jobMutex);
+        if (++iJobsDone == jobs.iCount)
+            pthread_cond_signal(&doneCond);
+    }
+    return NULL;
+} /* WatchThread() */
+//
+// Hand the list of files to the thread pool and wait for them to finish
+//
+void RunBatch(FILELIST *pList)
+{
+    if (pList->iCount == 0)
+        return;
+    pthread_mutex_lock(&jobMutex);
+    jobs.pNames = pList->pNames;
+    jobs.pOutNames = pList->pOutNames;
+    jobs.iCount = pList->iCount;
+    iNextJob = iJobsDone = 0;
+    pthread_cond_broadcast(&jobCond);
+    while (iJobsDone < jobs.iCount)
+        pthread_cond_wait(&doneCond, &jobMutex);
+    jobs.iCount = 0;
+    pthread_mutex_unlock(&jobMutex);
+    FreeFileList(pList);
+} /* RunBatch() */
+
+int WatchFiles(int argc, char *argv[], int iStart, char *szOutDir, CONVOPTS *pOpts, int iThreads)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char szName[MAX_PATH_LEN], szOutName[MAX_PATH_LEN];
+    const struct inotify_event *pEvent;
+    struct pollfd pfd;
+    struct stat st;
+    FILELIST changed;
+    pthread_t tid;
+    int i, fd, iLen;
+
+    szWatchOut = szOutDir;
+    pWatchOpts = pOpts;
+    pOpts->bAtomic = 1;
+    memset(&changed, 0, sizeof(changed));
+    fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Unable to start inotify\n");
+        return -1;
+    }
+    if (MakeDirs(szOutDir) != 0 || stat(szOutDir, &stWatchOut) != 0)
+    {
+        fprintf(stderr, "Unable to create the output directory: %s\n", szOutDir);
+        close(fd);
+        return -1;
+    }
+    ChecksumInit(); // build the CRC tables before the threads share them
+    if (iThreads <= 0)
+        iThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (iThreads > MAX_THREADS)
+        iThreads = MAX_THREADS;
+    for (i=0; i<iThreads; i++)
+    {
+        if (pthread_create(&tid, NULL, WatchThread, NULL) != 0)
+            break;
+        pthread_detach(tid);
+    }
+    if (i == 0)
+    {
+        fprintf(stderr, "Unable to start the worker threads\n");
+        return -1;
+    }
+    for (i=iStart; i<argc; i++)
+    {
+        if (stat(argv[i], &st) == 0 && S_ISREG(st.st_mode))
+            WatchFile(fd, argv[i], &changed);
+        else
+            WatchPath(fd, argv[i], "", &changed);
+    }
+    RunBatch(&changed); // convert everything once
+    fprintf(stderr, "Watching %d directories for changes (Ctrl-C to stop)\n", iWatchCount);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, -1) > 0)
+    {
+        do { // collect events until they stop for a moment
+            iLen = (int)read(fd, buf, sizeof(buf));
+            for (i=0; i<iLen; i += sizeof(struct inotify_event) + pEvent->len)
+            {
+                WATCHDIR *pWD;
+                int j;
+                pEvent = (const struct inotify_event *)&buf[i];
+                for (j=0; j<iWatchCount && pWatchDirs[j].wd != pEvent->wd; j++) {};
+                if (j == iWatchCount)
+                    continue;
+                pWD = &pWatchDirs[j];
+                if (pEvent->mask & IN_DELETE_SELF) // directory is gone
+                {
+                    free(pWD->szPath);
+                    free(pWD->szOut);
+                    FreeFileList(&pWD->named);
+                    free(pWD->named.pNames);
+                    free(pWD->named.pOutNames);
+                    *pWD = pWatchDirs[--iWatchCount];
+                    continue;
+                }
+                if (pEvent->len == 0)
+                    continue;
+                snprintf(szName, sizeof(szName), "%s/%s", pWD->szPath, pEvent->name);
+                if (pWD->bNamedOnly) // only the files from the command line
+                {
+                    for (j=0; j<pWD->named.iCount && strcmp(pWD->named.pNames[j], pEvent->name) != 0; j++) {};
+                    if (j < pWD->named.iCount && !(pEvent->mask & IN_ISDIR) && (pEvent->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+                        QueueFile(&changed, szName, pWD->named.pOutNames[j]);
+                    continue;
+                }
+                if (IgnoreName(pEvent->name))
+                    continue;
+                if (pWD->szOut[0])
+                    snprintf(szOutName, sizeof(szOutName), "%s/%s", pWD->szOut, pEvent->name);
+                else
+                    snprintf(szOutName, sizeof(szOutName), "%s", pEvent->name);
+                if (pEvent->mask & IN_ISDIR) // new directory, watch it and convert what's in it
+                {
+                    if (pEvent->mask & (IN_CREATE | IN_MOVED_TO))
+                        WatchPath(fd, szName, szOutName, &changed);
+                }
+                else if (pEvent->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                {
+                    WatchPath(fd, szName, szOutName, &changed); // queues it if it's still a file
+                }
+            }
+        } while (poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0);
+        RunBatch(&changed);
+    }
+    close(fd);
+    return 0;
+} /* WatchFiles() */
+#else
+int WatchFiles(int argc, char *argv[], int iStart, char *szOutDir, CONVOPTS *pOpts, int iThreads)
+{
+    fprintf(stderr, "--watch is only supported on Linux\n");
+    return -1;
+} /* WatchFiles() */
+#endif // __linux__
+#ifndef IMAGE_TO_C_NO_MAIN
 //
 // Main program entry point
 //
 int main(int argc, char *argv[])
 {
-    int iSize, iData;
-    int bStrip = 0;
+    int iData;
+    int bInfo = 0, bCSV = 0;
+    int bStatsJSON = 0;
+    int bShard = 0; // --shard was given (atoi() turns a bad size into 0)
+    int iThreads = 0;
     unsigned char *p;
     int iStart = 1; // starting parameter for input name
-    int iDataOff, iDataSize;
-    char szLeaf[256];
-    char szInfo[256];
+    char *pOutName = NULL;
+    char *pWatchDir = NULL;
+    CONVOPTS opts;
     
-    if (argc != 2 && argc != 3)
+    memset(&opts, 0, sizeof(opts));
+    
+    while (iStart < argc && strncmp(argv[iStart], "--", 2) == 0)
+    {
+        if (strcmp(argv[iStart], "--strip") == 0)
+            opts.bStrip = 1;
+        else if (strcmp(argv[iStart], "--info") == 0)
+            bInfo = 1;
+        else if (strcmp(argv[iStart], "--csv") == 0)
+            bCSV = 1;
+        else if (strcmp(argv[iStart], "--threads") == 0 && iStart+1 < argc)
+            iThreads = atoi(argv[++iStart]);
+        else if (strcmp(argv[iStart], "--stats") == 0)
+            bStats = 1;
+        else if (strcmp(argv[iStart], "--stats=json") == 0)
+            bStats = bStatsJSON = 1;
+        else if (strcmp(argv[iStart], "--out") == 0 && iStart+1 < argc)
+            pOutName = argv[++iStart];
+        else if (strcmp(argv[iStart], "--shard") == 0 && iStart+1 < argc)
+        {
+            bShard = 1;
+            opts.iShardSize = atoi(argv[++iStart]);
+        }
+        else if (strcmp(argv[iStart], "--shard-section") == 0)
+            opts.bShardSection = 1;
+        else if (strcmp(argv[iStart], "--align") == 0 && iStart+1 < argc)
+            opts.iAlign = atoi(argv[++iStart]);
+        else if (strcmp(argv[iStart], "--section") == 0 && iStart+1 < argc)
+            opts.szSection = argv[++iStart];
+        else if (strcmp(argv[iStart], "--dma-chunk") == 0 && iStart+1 < argc)
+            opts.iDMAChunk = atoi(argv[++iStart]);
+        else if (strcmp(argv[iStart], "--crc32") == 0)
+            iCRCType = CRC_32;
+        else if (strcmp(argv[iStart], "--crc32c") == 0)
+            iCRCType = CRC_32C;
+        else if (strcmp(argv[iStart], "--hash64") == 0)
+            bHash64 = 1;
+        else if (strcmp(argv[iStart], "--watch") == 0 && iStart+1 < argc)
+            pWatchDir = argv[++iStart];
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[iStart]);
+            return -1;
+        }
+        iStart++;
+    }
+    if ((bShard && opts.iShardSize <= 0) || (opts.iShardSize && pOutName == NULL && pWatchDir == NULL) || (opts.bShardSection && !opts.iShardSize))
+    {
+        fprintf(stderr, "--shard needs a size > 0 and --out (or --watch)\n");
+        return -1;
+    }
+    if (opts.iAlign < 0 || (opts.iAlign & (opts.iAlign-1)) || opts.iDMAChunk < 0 || (opts.iDMAChunk & (opts.iDMAChunk-1)))
+    {
+        fprintf(stderr, "--align and --dma-chunk must be powers of 2\n");
+        return -1;
+    }
+    if (opts.bShardSection && (opts.iShardSize % ((opts.iAlign > SHARD_SECTION_ALIGN) ? opts.iAlign : SHARD_SECTION_ALIGN)))
+    { // every shard is aligned (by the compiler if not by --align), so anything else leaves gaps between the sections
+        fprintf(stderr, "--shard-section needs a shard size which is a multiple of %d (or of --align if larger)\n", SHARD_SECTION_ALIGN);
+        return -1;
+    }
+    if (opts.iDMAChunk && opts.iShardSize)
+    {
+        fprintf(stderr, "--dma-chunk can't be used with --shard\n");
+        return -1;
+    }
+    if (opts.szSection && (strlen(opts.szSection) > 128 || strpbrk(opts.szSection, "\"\\")))
+    {
+        fprintf(stderr, "Invalid section name: %s\n", opts.szSection);
+        return -1;
+    }
+    if (pWatchDir && (bInfo || bStats || pOutName))
+    {
+        fprintf(stderr, "--watch can't be used with --info, --stats or --out\n");
+        return -1;
+    }
+    if (iStart >= argc || (!bInfo && !pWatchDir && iStart != argc-1))
     {
         printf("image_to_c Copyright (c) 2020 BitBank Software, Inc.\n");
         printf("Written by Larry Bank\n\n");
-        printf("Usage: image_to_c <option> <filename>\n");
+        printf("Usage: image_to_c <options> <filename>\n");
+        printf("       image_to_c --info [--csv] [--threads n] <files or directories>\n");
+        printf("       image_to_c --watch <output dir> [options] [--threads n] <files or directories>\n");
         printf("output is written to stdout\n");
         printf("example:\n\n");
         printf("image_to_c ./test.jpg > test.h\n");
         printf("image_to_c --strip ./test.tif > test.h\n");
+        printf("image_to_c --info ./assets > manifest.jsonl\n");
+        printf("image_to_c --shard 32768 --out gen/test ./test.png\n");
+        printf("image_to_c --watch ./gen ./assets\n");
         printf("--strip = remove all metadata and just save the compressed image\n");
         printf("This option is only available for TIFF & BMP files (for now)\n");
+        printf("--info = only probe the headers (recursing into directories) and write\n");
+        printf("         one JSON record per file (or CSV with --csv); no hex data is written\n");
+        printf("--threads n = number of threads used by --info and --watch (default = number of CPUs)\n");
+        printf("--stats = print the time spent in each phase and the I/O counts to stderr\n");
+        printf("          (--stats=json for JSON); --info runs on a single thread with --stats\n");
+        printf("--out <file> = write to a file instead of stdout\n");
+        printf("--shard n = split the array into .c files of n bytes each (<out>_0.c, <out>_1.c...)\n");
+        printf("            declared in <out>.h, so that they can be compiled in parallel\n");
+        printf("--shard-section = place each shard in its own section for contiguous linking\n");
+        printf("                  (the shard size must be a multiple of 32, or of --align if larger)\n");
+        printf("--align n = align the array to n bytes (power of 2)\n");
+        printf("--section <name> = place the array in the named section instead of PROGMEM\n");
+        printf("--dma-chunk n = add a linked list of DMA descriptors (<name>_dma) which covers the\n");
+        printf("                array in pieces of n bytes that never cross an n byte boundary\n");
+        printf("                (the array is aligned to n, or to its size rounded up to a power of 2 if smaller)\n");
+        printf("--crc32 or --crc32c = add a <name>_crc constant with the CRC of the array data\n");
+        printf("--hash64 = add a <name>_hash constant with the 64-bit FNV-1a hash of the array data\n");
+        printf("--watch <dir> = convert the images in the given files/directories to <dir>/<path>/<name>.h,\n");
+        printf("                then keep watching them and reconvert whatever changes (Linux only)\n");
         return 0; // no filename passed
     }
-    if (strcmp(argv[1], "--strip") == 0) {
-       iStart++;
-       bStrip = 1;
-    }
-    ihandle = fopen(argv[iStart],"rb"); // open input file
-    if (ihandle == NULL)
+    ohandle = stdout;
+    StatPhase(PHASE_OTHER);
+    if (bInfo)
     {
-        fprintf(stderr, "Unable to open file: %s\n", argv[iStart]);
-        return -1; // bad filename passed
+        if (bStats)
+            iThreads = 1; // the counters aren't shared between threads
+        iData = ProbeFiles(argc, argv, iStart, bCSV, iThreads);
+        if (bStats)
+            PrintStats(bStatsJSON);
+        return iData;
     }
-    
-    fseek(ihandle, 0L, SEEK_END); // get the file size
-    iSize = (int)ftell(ihandle);
-    fseek(ihandle, 0, SEEK_SET);
-    iDataSize = ImageInfo(ihandle, iSize, szInfo, &iDataOff); // get image info
-    p = (unsigned char *)malloc(0x10000); // allocate 64k to play with
-    GetLeafName(argv[iStart], szLeaf);
-    printf("// Created with image_to_c\n// https://github.com/bitbank2/image_to_c\n");
-    if (bStrip && iDataOff != iDataSize) {
-       iStart = iDataOff;
-       printf("//\n// This hex data is only the image; the header + metadata has been removed\n");
-       printf("// %s\n// File size = %d bytes, this data = %d bytes\n//\n", szLeaf, iSize, iDataSize); 
-    } else {
-       bStrip = 0; // disable stripping if not possible to use it
-       printf("//\n// %s\n// Data size = %d bytes\n//\n", szLeaf, iSize); // comment header with filename
-    }
-    if (szInfo[0])
-        printf("%s", szInfo);
-    FixName(szLeaf); // remove unusable characters
-    printf("// for non-Arduino builds...\n");
-    printf("#ifndef PROGMEM\n#define PROGMEM\n#endif\n");
-    printf("const uint8_t %s[] PROGMEM = {\n", szLeaf); // start of data array
-    if (bStrip) {
-       int iLen;
-       fseek(ihandle, iDataOff, SEEK_SET);
-       while (iDataSize)
-       {
-           iLen = 0x10000;
-           if (iLen > iDataSize) iLen = iDataSize;
-           iData = fread(p, 1, iLen, ihandle); // try to read 64k
-           MakeC(p, iData, iDataSize == iData); // create the output data
-           iDataSize -= iData;
-       }
-    } else {
-       fseek(ihandle, 0, SEEK_SET);
-       while (iSize)
-       {
-           iData = fread(p, 1, 0x10000, ihandle); // try to read 64k
-           MakeC(p, iData, iSize == iData); // create the output data
-           iSize -= iData;
-       }
-    } // bStrip
+    if (pWatchDir)
+        return WatchFiles(argc, argv, iStart, pWatchDir, &opts, iThreads);
+    p = (unsigned char *)StatAlloc(0x10000); // allocate 64k to play with
+    iData = ConvertFile(argv[iStart], pOutName, &opts, p, 0);
     free(p);
-    fclose(ihandle);
-    printf("};\n"); // final closing brace
-    return 0;
+    if (bStats)
+    {
+        StatPhase(PHASE_WRITE);
+        fflush(stdout); // include the last of the stdout back-pressure
+        PrintStats(bStatsJSON);
+    }
+    return iData;
 } /* main() */
+#endif // IMAGE_TO_C_NO_MAIN
+//
+// Read iLen bytes of the input file starting at iOffset
+// and write them as hex (64k at a time)
+//
+void WriteData(unsigned char *p, int iOffset, int iLen)
+{
+    int iData, iRead;
+
+    StatSeek(ihandle, iOffset, SEEK_SET);
+    while (iLen)
+    {
+        iRead = (iLen > 0x10000) ? 0x10000 : iLen;
+        StatPhase(PHASE_READ);
+        iData = StatRead(p, 1, iRead, ihandle); // try to read 64k
+        if (iData <= 0) // truncated file
+            break;
+        if (iCRCType != CRC_NONE || bHash64)
+            ChecksumUpdate(p, iData);
+        MakeC(p, iData, iLen == iData); // create the output data
+        iLen -= iData;
+    }
+    StatPhase(PHASE_OTHER);
+} /* WriteData() */
 //
 // Generate C hex characters from each byte of file data
+// Lines of 16 bytes are formatted into a local buffer with a table
+// lookup and written in large blocks (much faster than printf per byte)
 //
+#define MAKEC_BLOCK 4096 // input bytes per write (must be a multiple of 16)
 void MakeC(unsigned char *p, int iLen, int bLast)
 {
-    int i, j, iCount;
-    char szTemp[256], szOut[256];
+    static const char szHex[] = "0123456789abcdef";
+    char szOut[(MAKEC_BLOCK/16) * (16*5 + 2)];
+    char *d;
+    int i, iCount, iOld;
+    unsigned char c;
     
+    iOld = StatPhase(PHASE_FORMAT);
     iCount = 0;
-    for (i=0; i<iLen>>4; i++) // do lines of 16 bytes
+    d = szOut;
+    while (iCount < iLen)
     {
-        strcpy(szOut, "\t");
-        for (j=0; j<16; j++)
+        *d++ = '\t';
+        for (i=0; i<16 && iCount < iLen; i++)
         {
-            if (iCount == iLen-1 && bLast) // last one, skip the comma
-                sprintf(szTemp, "0x%02x", p[(i*16)+j]);
-            else
-                sprintf(szTemp, "0x%02x,", p[(i*16)+j]);
-            strcat(szOut, szTemp);
-            iCount++;
+            c = p[iCount++];
+            *d++ = '0'; *d++ = 'x';
+            *d++ = szHex[c >> 4];
+            *d++ = szHex[c & 0xf];
+            if (iCount != iLen || !bLast) // last one, skip the comma
+                *d++ = ',';
         }
-        if (!bLast || iCount != iLen)
-            strcat(szOut, "\n");
-        printf("%s",szOut);
-    }
-    p += (iLen & 0xfff0); // point to last section
-    if (iLen & 0xf) // any remaining characters?
-    {
-        strcpy(szOut, "\t");
-        for (j=0; j<(iLen & 0xf); j++)
+        if (iCount != iLen || !bLast)
+            *d++ = '\n';
+        if ((iCount & (MAKEC_BLOCK-1)) == 0 || iCount == iLen) // buffer full or done
         {
-            if (iCount == iLen-1 && bLast)
-                sprintf(szTemp, "0x%02x", p[j]);
-            else
-                sprintf(szTemp, "0x%02x,", p[j]);
-            strcat(szOut, szTemp);
-            iCount++;
+            StatPhase(PHASE_WRITE);
+            StatWrite(szOut, (int)(d - szOut));
+            StatPhase(PHASE_FORMAT);
+            d = szOut;
         }
-        if (!bLast)
-            strcat(szOut, "\n");
-        printf("%s",szOut);
     }
+    StatPhase(iOld);
 } /* MakeC() */
 //
 // Make sure the name can be used in C/C++ as a variable